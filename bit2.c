@@ -8,14 +8,17 @@
  *     creation of a 2D bit array. The user of the bit2 interface can create
  *     a 2D array, get the width and height, put elements into the array,
  *     get elements from the array, use row and column mapping capabilities,
- *     and free memory for the 2D array.
+ *     and free memory for the 2D array. Bits are packed row by row into
+ *     words, each row starting on a new word.
  */
 
 #include "bit2.h" //From Hanson's "C Interfaces and Implementations: Techniques for Creating Reusable Software"
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <limits.h>
 #define T Bit2_T
+#define WORD_BITS (sizeof(unsigned long) * CHAR_BIT)
 
 /************************** T Bit2_T **************************
 *
@@ -23,22 +26,36 @@
 * 
 * Parameters:
 *    
-*        UArray_T cols_array: pointer to array of columns in 2D array
+*        unsigned long *words: packed bits, row major
 *        int num_col: number of columns
 *        int num_row: number of rows
-*        int num_elements: number of elements
-*        int size_elem: size of each element
+*        int words_per_row: number of words holding each row
                     
 *****************************************************************/
 struct T {
-        UArray_T cols_array;
+        unsigned long *words;
         int num_col;
         int num_row;
-        int num_elements;
-        int size_elem;
+        int words_per_row;
 };
 
 
+/************************** word_at **************************
+*
+* Returns the word holding the bit at col, row and sets *mask to that bit
+*                        
+*****************************************************************/
+static unsigned long *word_at(T bit2, int col, int row, unsigned long *mask)
+{
+        assert(bit2 != NULL);
+        assert(col >= 0 && col < bit2->num_col);
+        assert(row >= 0 && row < bit2->num_row);
+        *mask = 1UL << (col % WORD_BITS);
+        return &bit2->words[(size_t)row * bit2->words_per_row + 
+                            col / WORD_BITS];
+}
+
+
 /************************** Bit2_new **************************
 *
 * This function will initialize a 2D array with the specified width, height.
@@ -70,30 +87,16 @@ T Bit2_new (int col, int row)
         T new_array = (T)malloc(sizeof(struct T));
         assert(new_array != NULL);
 
-        /*  Allocate memory for the outer array. Each element is a bit vector*/
-        new_array->cols_array = UArray_new(col, sizeof(Bit_T));
-        assert(new_array->cols_array != NULL);
-    
-        
-        for (int i = 0; i < col; i++) {
-                Bit_T Bit_array = Bit_new(row); /*creating new bit vector */
-                assert (Bit_array != NULL);
-                /* casting pointer that UArray returns  */
-                Bit_T *element = (Bit_T*)UArray_at(new_array->cols_array, i);
-                assert(element != NULL);
-                /* dereference pointer to access element */
-                *element = Bit_array; 
-                (void) element;
-        }
-
-        /* setting number of columns to the length of outer UArray */
-        new_array->num_col = UArray_length(new_array->cols_array);
+        new_array->num_col = col;
+        new_array->num_row = row;
+        /* round each row up to whole words */
+        new_array->words_per_row = (col + WORD_BITS - 1) / WORD_BITS;
 
-        /* accesing first element of outer Uarray */
-        Bit_T *first_element = (Bit_T *)UArray_at(new_array->cols_array, 0);
-        assert(first_element != NULL);
-        /* getting length of first bit vector in the UArray */
-        new_array->num_row = Bit_length(*first_element); 
+        /* all bits start at 0; allocate at least one word for empty arrays */
+        size_t num_words = (size_t)new_array->words_per_row * row;
+        new_array->words = calloc(num_words > 0 ? num_words : 1, 
+                                  sizeof(unsigned long));
+        assert(new_array->words != NULL);
 
         return new_array;
 }
@@ -169,9 +172,15 @@ int Bit2_height (T bit2)
 int Bit2_put(T bit2, int col, int row, int value) 
 {
         assert(bit2 != NULL);
-        Bit_T *bit_vector = (Bit_T *)UArray_at(bit2->cols_array, col);
-        assert(bit_vector != NULL);
-        int prev_value = Bit_put(*bit_vector,row, value);
+        assert(value == 0 || value == 1);
+        unsigned long mask;
+        unsigned long *word = word_at(bit2, col, row, &mask);
+        int prev_value = (*word & mask) != 0;
+        if (value == 1) {
+                *word |= mask;
+        } else {
+                *word &= ~mask;
+        }
         return prev_value;
 }
 
@@ -198,12 +207,48 @@ int Bit2_put(T bit2, int col, int row, int value)
 *****************************************************************/   
 int Bit2_get(T bit2, int col, int row) {
         assert(bit2 != NULL);
-        Bit_T *bit_vector = (Bit_T *)UArray_at(bit2->cols_array, col);
-        assert(bit_vector != NULL);
-        int desired_bit = Bit_get(*bit_vector, row);
+        unsigned long mask;
+        unsigned long *word = word_at(bit2, col, row, &mask);
+        int desired_bit = (*word & mask) != 0;
         return desired_bit;
 }
 
+/************************** Bit2_clear_atomic **************************
+*
+* This function atomically sets the bit at the specified row and col to 0
+* and returns its previous value. When several threads clear the same bit
+* concurrently, exactly one of them gets back a 1, so it can be used to
+* claim a pixel.
+* 
+* Parameters:
+*      T bit2:    the specified array
+*      int col: column of bit to clear
+*      int row: row of bit to clear
+*
+* Return: 
+*       returns the previous value of the bit
+* Expects
+*       Bit2_T is a valid pointer (not NULL) and is correctly initialized
+*      
+* 
+* Notes:
+*       Will checked runtime error (CRE) if Bit2_T is NULL. Must not race
+*       with Bit2_put on the same array.
+*                        
+*****************************************************************/   
+int Bit2_clear_atomic(T bit2, int col, int row) {
+        assert(bit2 != NULL);
+        unsigned long mask;
+        unsigned long *word = word_at(bit2, col, row, &mask);
+        /* skip the read-modify-write when the bit is already clear */
+        if ((__atomic_load_n(word, __ATOMIC_RELAXED) & mask) == 0) {
+                return 0;
+        }
+        unsigned long prev = __atomic_fetch_and(word, ~mask, 
+                                                __ATOMIC_RELAXED);
+        return (prev & mask) != 0;
+}
+
 /************************** Bit2_map_col_major **************************
 *
 * This function will traverse the array in a column major order 
@@ -304,16 +349,10 @@ void Bit2_map_row_major(T bit2,
 void Bit2_free(T *bit2) 
 {
         assert(bit2 != NULL);
-        /* freeing each inner bit vector */
-        for (int i = 0; i < (*bit2)->num_col; i++) {
-                Bit_T *current_element = 
-                                (Bit_T *)UArray_at((*bit2)->cols_array, i);
-                assert(current_element != NULL);
-                Bit_free(current_element);
-        }
-        /*free outer array */
-        assert((*bit2)->cols_array != NULL); 
-        UArray_free(&((*bit2)->cols_array));
+        assert(*bit2 != NULL);
+        /* freeing packed words */
+        free((*bit2)->words);
         free(*bit2); 
+        *bit2 = NULL;
 }
 
@@ -9,8 +9,6 @@
 
 #ifndef BIT2
 #define BIT2
-#include "bit.h"
-#include "uarray.h"
 #define T Bit2_T
 typedef struct T *T;
 
@@ -26,6 +24,10 @@ int Bit2_put(T bit2, int col, int row, int value);
 /* Get gets the value at the specified col, row. Returns bit you get */
 int Bit2_get(T bit2, int col, int row);
 
+/* atomically clears the bit at col, row. Returns previous value, so exactly
+ * one of several threads clearing the same bit sees a 1 */
+int Bit2_clear_atomic(T bit2, int col, int row);
+
 void Bit2_map_col_major(T bit2, 
         void (*function_name)(int col, int row, 
         T bitarray, int correct_val, void *cl), void *cl);
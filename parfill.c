@@ -0,0 +1,384 @@
+/*
+ *     parfill.c
+ *     Mallika Rangan
+ *
+ *     Summary: This file contains the implementation for parfill.c. parfill.c
+ *     is to be used with the parfill.h interface. It flood fills from a set
+ *     of seed pixels in parallel. Each thread owns a deque of pixels still
+ *     to be expanded; it works from the bottom of its own deque and, when
+ *     that runs dry, steals from the top of another thread's deque. A pixel
+ *     is claimed by atomically clearing its bit, so each pixel is whitened
+ *     exactly once and the work done stays proportional to the region
+ *     removed. The whitened region does not depend on thread scheduling.
+ */
+
+#include "parfill.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* pixels taken from the own deque per lock */
+#define BATCH 64
+/* most pixels taken from another deque per steal */
+#define STEAL_MAX 256
+
+
+/************************** point struct **************************
+*
+* holds info about col and row of a claimed pixel
+*
+* Parameters:
+*
+*       col:          The column index of the pixel
+*       row:          The row index of the pixel
+
+*****************************************************************/
+struct point {
+        int col;
+        int row;
+};
+
+
+/************************** deque struct **************************
+*
+* holds the pixels a thread still has to expand. The owner pushes and pops
+* at the bottom, thieves take from the top.
+*
+* Parameters:
+*
+*       lock:         Protects the other fields
+*       items:        Pixels in the deque, from top to bottom - 1
+*       top:          Index of the oldest pixel
+*       bottom:       Index one past the newest pixel
+*       capacity:     Number of pixels items has room for
+
+*****************************************************************/
+struct deque {
+        pthread_mutex_t lock;
+        struct point *items;
+        int top;
+        int bottom;
+        int capacity;
+};
+
+
+/************************** fill_info struct **************************
+*
+* holds info shared by all the threads of one fill
+*
+* Parameters:
+*
+*       bit2:         The array being whitened
+*       deques:       One deque per thread
+*       num_threads:  Number of threads and deques
+*       pending:      Pixels claimed but not yet expanded
+
+*****************************************************************/
+struct fill_info {
+        Bit2_T bit2;
+        struct deque *deques;
+        int num_threads;
+        long pending;
+};
+
+
+/************************** worker_info struct **************************
+*
+* holds the closure passed to one thread
+*
+* Parameters:
+*
+*       fill:         The shared fill info
+*       id:           Index of the thread and of its deque
+
+*****************************************************************/
+struct worker_info {
+        struct fill_info *fill;
+        int id;
+};
+
+
+/************************** deque_push **************************
+*
+* Pushes count pixels onto the bottom of a deque, growing it as needed.
+*
+* Parameters:
+*       deque:        The deque to push onto
+*       points:       The pixels to push
+*       count:        Number of pixels to push
+* Return:
+*       Void
+*
+* Expects:
+*       Valid deque, count >= 0
+*
+*****************************************************************/
+static void deque_push(struct deque *deque, const struct point *points,
+                       int count)
+{
+        assert (deque != NULL);
+        pthread_mutex_lock(&deque->lock);
+        if (deque->bottom + count > deque->capacity) {
+                /* move live pixels down before growing */
+                int length = deque->bottom - deque->top;
+                memmove(deque->items, deque->items + deque->top,
+                        length * sizeof(struct point));
+                deque->top = 0;
+                deque->bottom = length;
+                while (deque->bottom + count > deque->capacity) {
+                        deque->capacity *= 2;
+                }
+                deque->items = realloc(deque->items,
+                                deque->capacity * sizeof(struct point));
+                assert (deque->items != NULL);
+        }
+        memcpy(deque->items + deque->bottom, points,
+               count * sizeof(struct point));
+        deque->bottom += count;
+        pthread_mutex_unlock(&deque->lock);
+}
+
+
+/************************** deque_pop **************************
+*
+* Pops up to max pixels from the bottom of a deque, newest first.
+*
+* Parameters:
+*       deque:        The deque to pop from
+*       points:       Where to put the popped pixels
+*       max:          Most pixels to pop
+* Return:
+*       The number of pixels popped
+*
+* Expects:
+*       Valid deque, room for max pixels in points
+*
+*****************************************************************/
+static int deque_pop(struct deque *deque, struct point *points, int max)
+{
+        assert (deque != NULL);
+        pthread_mutex_lock(&deque->lock);
+        int count = 0;
+        while (count < max && deque->bottom > deque->top) {
+                points[count++] = deque->items[--deque->bottom];
+        }
+        if (deque->bottom == deque->top) {
+                deque->top = deque->bottom = 0;
+        }
+        pthread_mutex_unlock(&deque->lock);
+        return count;
+}
+
+
+/************************** deque_steal **************************
+*
+* Takes half of the pixels, at most max, from the top of a deque.
+*
+* Parameters:
+*       deque:        The deque to steal from
+*       points:       Where to put the stolen pixels
+*       max:          Most pixels to steal
+* Return:
+*       The number of pixels stolen
+*
+* Expects:
+*       Valid deque, room for max pixels in points
+*
+*****************************************************************/
+static int deque_steal(struct deque *deque, struct point *points, int max)
+{
+        assert (deque != NULL);
+        pthread_mutex_lock(&deque->lock);
+        int count = (deque->bottom - deque->top + 1) / 2;
+        if (count > max) {
+                count = max;
+        }
+        memcpy(points, deque->items + deque->top,
+               count * sizeof(struct point));
+        deque->top += count;
+        if (deque->bottom == deque->top) {
+                deque->top = deque->bottom = 0;
+        }
+        pthread_mutex_unlock(&deque->lock);
+        return count;
+}
+
+
+/************************** expand **************************
+*
+* Claims the black neighbours of a batch of pixels and pushes them onto the
+* thread's deque, then marks the batch as done.
+*
+* Parameters:
+*       fill:         The shared fill info
+*       id:           Index of the expanding thread
+*       batch:        The pixels to expand
+*       count:        Number of pixels in batch
+* Return:
+*       Void
+*
+* Expects:
+*       Valid fill info, pixels in batch already claimed
+*
+*****************************************************************/
+static void expand(struct fill_info *fill, int id, const struct point *batch,
+                   int count)
+{
+        static const int dcol[4] = { 0, 1, 0, -1 };
+        static const int drow[4] = { -1, 0, 1, 0 };
+        struct point claimed[4 * STEAL_MAX];
+        int width = Bit2_width(fill->bit2);
+        int height = Bit2_height(fill->bit2);
+        int num_claimed = 0;
+
+        for (int i = 0; i < count; i++) {
+                for (int d = 0; d < 4; d++) {
+                        int col = batch[i].col + dcol[d];
+                        int row = batch[i].row + drow[d];
+                        /*prevent getting out of bounds*/
+                        if (col < 0 || col >= width ||
+                            row < 0 || row >= height) {
+                                continue;
+                        }
+                        if (Bit2_clear_atomic(fill->bit2, col, row)) {
+                                claimed[num_claimed].col = col;
+                                claimed[num_claimed].row = row;
+                                num_claimed++;
+                        }
+                }
+        }
+
+        /* count new pixels before retiring the batch so pending never
+         * reaches 0 while work is left */
+        if (num_claimed > 0) {
+                __atomic_add_fetch(&fill->pending, num_claimed,
+                                   __ATOMIC_RELAXED);
+                deque_push(&fill->deques[id], claimed, num_claimed);
+        }
+        __atomic_sub_fetch(&fill->pending, count, __ATOMIC_RELEASE);
+}
+
+
+/************************** worker **************************
+*
+* Thread body. Expands pixels from its own deque, steals from the other
+* deques when it is empty, and returns once no claimed pixel is pending.
+*
+* Parameters:
+*       void *cl:     The worker_info closure
+* Return:
+*       NULL
+*
+* Expects:
+*       Valid closure
+*
+*****************************************************************/
+static void *worker(void *cl)
+{
+        assert (cl != NULL);
+        struct worker_info *info = (struct worker_info *)cl;
+        struct fill_info *fill = info->fill;
+        int id = info->id;
+        struct point batch[STEAL_MAX];
+
+        for (;;) {
+                int count = deque_pop(&fill->deques[id], batch, BATCH);
+                /* own deque is empty, try the others in a fixed order */
+                for (int k = 1; count == 0 && k < fill->num_threads; k++) {
+                        int victim = (id + k) % fill->num_threads;
+                        count = deque_steal(&fill->deques[victim], batch,
+                                            STEAL_MAX);
+                }
+                if (count > 0) {
+                        expand(fill, id, batch, count);
+                } else if (__atomic_load_n(&fill->pending, 
+                                           __ATOMIC_ACQUIRE) == 0) {
+                        break;
+                } else {
+                        /* others still hold work that may spill over */
+                        sched_yield();
+                }
+        }
+        return NULL;
+}
+
+
+/************************** Parfill_whiten **************************
+*
+* Whitens every black pixel 4-connected to one of the seeds. Black seeds are
+* claimed and dealt round robin to the threads' deques, then the threads
+* expand the frontier until no claimed pixel is left. The result is the same
+* as a serial fill from the same seeds.
+*
+* Parameters:
+*       bit2:         The array to whiten
+*       seeds:        num_seeds col, row pairs; white seeds are skipped
+*       num_seeds:    Number of seeds
+*       num_threads:  Number of threads to fill with
+* Return:
+*       Void
+*
+* Expects:
+*       Valid array, seeds in bounds, num_threads >= 1
+*
+* Notes:
+*       No other thread may use bit2 during the fill
+*
+*****************************************************************/
+void Parfill_whiten(Bit2_T bit2, const int *seeds, int num_seeds,
+                    int num_threads)
+{
+        assert (bit2 != NULL);
+        assert (seeds != NULL || num_seeds == 0);
+        assert (num_threads >= 1);
+
+        struct fill_info fill = { bit2, NULL, num_threads, 0 };
+        fill.deques = malloc(num_threads * sizeof(struct deque));
+        assert (fill.deques != NULL);
+        for (int i = 0; i < num_threads; i++) {
+                struct deque *deque = &fill.deques[i];
+                pthread_mutex_init(&deque->lock, NULL);
+                deque->top = deque->bottom = 0;
+                deque->capacity = 1024;
+                deque->items = malloc(deque->capacity * 
+                                      sizeof(struct point));
+                assert (deque->items != NULL);
+        }
+
+        /* claim black seeds before any thread starts */
+        for (int i = 0; i < num_seeds; i++) {
+                struct point seed = { seeds[2 * i], seeds[2 * i + 1] };
+                if (Bit2_clear_atomic(bit2, seed.col, seed.row)) {
+                        int owner = fill.pending % num_threads;
+                        deque_push(&fill.deques[owner], &seed, 1);
+                        fill.pending++;
+                }
+        }
+
+        pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+        struct worker_info *infos = 
+                malloc(num_threads * sizeof(struct worker_info));
+        assert (threads != NULL);
+        assert (infos != NULL);
+        for (int i = 0; i < num_threads; i++) {
+                infos[i].fill = &fill;
+                infos[i].id = i;
+                int rc = pthread_create(&threads[i], NULL, worker, &infos[i]);
+                assert (rc == 0);
+                (void) rc;
+        }
+        for (int i = 0; i < num_threads; i++) {
+                pthread_join(threads[i], NULL);
+        }
+
+        for (int i = 0; i < num_threads; i++) {
+                pthread_mutex_destroy(&fill.deques[i].lock);
+                free(fill.deques[i].items);
+        }
+        free(fill.deques);
+        free(threads);
+        free(infos);
+}
@@ -0,0 +1,20 @@
+/*
+ *     parfill.h
+ *     Mallika Rangan
+ *
+ *     Summary: This file contains the interface for parfill.h, which is to be
+ *     used with the parfill.c implementation. Parfill whitens every black
+ *     pixel connected to a set of seed pixels, using several threads that
+ *     share the work by stealing from each other.
+ */
+
+#ifndef PARFILL
+#define PARFILL
+#include "bit2.h"
+
+/* whitens every black pixel 4-connected to one of the num_seeds seeds,
+ * given as col, row pairs in seeds, using num_threads threads */
+void Parfill_whiten(Bit2_T bit2, const int *seeds, int num_seeds,
+                    int num_threads);
+
+#endif
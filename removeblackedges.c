@@ -5,17 +5,23 @@
  *     removeblackedges.c is the implementation to remove the black edges of a provided
  *     file. removeblackedges takes in a pbm file, and assesses whether something is a black edge or
  *     not, using recursion. If it is, it whitens the edge and prints a bitmap to represent
- *     the whitened pbm.
+ *     the whitened pbm. A pgm file may be given instead; its pixels are
+ *     thresholded into black and white as they are read.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 #include <assert.h>
 #include <bit2.h>
+#include <parfill.h>
 #include <pnmrdr.h>
 #include <seq.h>
 
+/* threshold value asking for a global Otsu threshold to be computed */
+#define OTSU_THRESHOLD -1
 
 /************************** bit_info struct **************************
 *
@@ -142,6 +148,48 @@ void process_bit (Bit2_T filled_array, Seq_T stack) {
 }
 
 
+/************************** process_bit_parallel **************************
+*
+* Whitens the same pixels as process_bit, using num_threads threads that
+* expand the frontier from the edge pixels in the stack. Only the pixels
+* connected to the edges are visited, and the result is identical to
+* process_bit's.
+* 
+* Parameters:
+*       filled_array: A Bit2_T 2D bit array representing the filled image.
+*       A Seq_T sequence holding the edge pixels found by add_edges. It is
+*                     empty on return
+*       num_threads:  Number of threads to fill with
+*
+* Return: 
+*       Void
+*
+* Expects:
+*      Valid sequence, filled array, num_threads >= 1
+*
+*                        
+*****************************************************************/
+void process_bit_parallel (Bit2_T filled_array, Seq_T stack, 
+                           int num_threads) {
+        assert (filled_array != NULL);
+        assert (stack != NULL);
+        int num_seeds = Seq_length(stack);
+        int *seeds = malloc((2 * num_seeds + 1) * sizeof(int));
+        assert (seeds != NULL);
+        /* flatten the stack into col, row pairs */
+        for (int i = 0; i < num_seeds; i++) {
+                struct bit_info *curr_struct = 
+                        (struct bit_info*)Seq_remhi(stack);
+                assert(curr_struct != NULL);
+                seeds[2 * i] = curr_struct->col;
+                seeds[2 * i + 1] = curr_struct->row;
+                free(curr_struct);
+        }
+        Parfill_whiten(filled_array, seeds, num_seeds, num_threads);
+        free(seeds);
+}
+
+
 /************************** add_edges **************************
 *
 * This function adds the edges of a filled 2D bit array to a sequence for
@@ -248,6 +296,173 @@ Bit2_T store_pbm(Pnmrdr_T newReader) {
 }
 
 
+/************************** gray_info struct **************************
+*
+* holds info needed to binarise gray pixels while storing them
+* 
+* Parameters:
+*    
+*       reader:       The Pnmrdr_T reader pixels are read from when
+*                     pixels is NULL
+*       pixels:       Gray values already read in row major order, or NULL
+*       next:         Index of the next value to take from pixels
+*       threshold:    Gray values at or below this are stored as black (1)
+                    
+*****************************************************************/
+struct gray_info {
+        Pnmrdr_T reader;
+        unsigned short *pixels;
+        int next;
+        unsigned threshold;
+};
+
+
+/************************** get_gray_bit **************************
+*
+* Callback function used to binarise each pixel of a portable graymap (PGM)
+* and store it in a Bit2_T (2D bit array). The gray value is taken from the
+* reader, or from the buffered pixels when the threshold had to be computed
+* first.
+* 
+* Parameters:
+*       int col: Column index of the pixel in the 2D array.
+*       int row: Row index of the pixel in the 2D array.
+*       bitarray: The Bit2_T object (2D bit array) in which to store the bit.
+*       void *p1: Unused parameter.
+*       the gray_info closure
+*
+* Return: 
+*       Void
+*
+* Expects:
+*       Valid closure, col and int that are in bounds, valid bit array
+* Notes:
+*       *p1 parameter is unused
+*                        
+*****************************************************************/
+void get_gray_bit(int col, int row, Bit2_T bitarray, int p1, void *cl) {
+        assert (cl != NULL);
+        assert (bitarray != NULL);
+        
+        struct gray_info *info = (struct gray_info *)cl;
+        (void) p1;
+
+        unsigned value;
+        if (info->pixels != NULL) {
+                value = info->pixels[info->next++];
+        } else {
+                value = Pnmrdr_get(info->reader);
+        }
+        /* dark pixels become black bits */
+        Bit2_put(bitarray, col, row, value <= info->threshold);
+}
+
+
+/************************** otsu_threshold **************************
+*
+* Computes the global Otsu threshold of a gray histogram: the gray value
+* that maximises the between-class variance of the pixels at or below it
+* and the pixels above it.
+* 
+* Parameters:
+*       histogram:    Count of pixels for each gray value 0..maxval
+*       maxval:       The largest gray value of the image
+*       total:        Number of pixels counted in the histogram
+* Return: 
+*       The threshold, a gray value between 0 and maxval
+*
+* Expects:
+*       Valid histogram, total > 0
+*                        
+*****************************************************************/
+unsigned otsu_threshold(unsigned long *histogram, unsigned maxval,
+                        unsigned long total) {
+        assert (histogram != NULL);
+        assert (total > 0);
+        double sum = 0;
+        for (unsigned i = 0; i <= maxval; i++) {
+                sum += (double) i * histogram[i];
+        }
+
+        double sum_low = 0;
+        unsigned long count_low = 0;
+        double best_variance = -1;
+        unsigned best = 0;
+        for (unsigned t = 0; t <= maxval; t++) {
+                count_low += histogram[t];
+                sum_low += (double) t * histogram[t];
+                unsigned long count_high = total - count_low;
+                if (count_low == 0 || count_high == 0) {
+                        continue;
+                }
+                double mean_low = sum_low / count_low;
+                double mean_high = (sum - sum_low) / count_high;
+                double diff = mean_low - mean_high;
+                double variance = (double) count_low * count_high * 
+                                  diff * diff;
+                if (variance > best_variance) {
+                        best_variance = variance;
+                        best = t;
+                }
+        }
+        return best;
+}
+
+
+/************************** store_pgm **************************
+*
+* Reads a portable graymap (PGM) image from a Pnmrdr_T object and stores it
+* binarised in a Bit2_T (2D bit array). With a fixed threshold each pixel is
+* packed into the bit array as it is read. With OTSU_THRESHOLD the gray
+* values and their histogram are gathered in the same read, and are
+* binarised once the threshold is known, so the file is only read once.
+* 
+* Parameters:
+*        newReader: The Pnmrdr_T object representing the PGM image to be read.
+*        threshold: Gray values at or below this become black, or
+*                   OTSU_THRESHOLD to compute one from the image
+* Return: 
+*       A Bit2_T object containing the binarised PGM image data
+*
+* Expects:
+*       Valid reader
+*
+*                        
+*****************************************************************/
+Bit2_T store_pgm(Pnmrdr_T newReader, int threshold) {
+        assert (newReader != NULL);
+        Pnmrdr_mapdata newMapData = Pnmrdr_data(newReader);
+        int col = newMapData.width;
+        int row = newMapData.height;
+        unsigned maxval = newMapData.denominator;
+        assert (maxval <= 65535);
+        Bit2_T bit_array = Bit2_new (col, row);
+
+        struct gray_info info = { newReader, NULL, 0, threshold };
+        if (threshold == OTSU_THRESHOLD) {
+                unsigned long total = (unsigned long) col * row;
+                unsigned long *histogram = 
+                        calloc(maxval + 1, sizeof(*histogram));
+                info.pixels = malloc(total * sizeof(*info.pixels));
+                assert (histogram != NULL);
+                assert (info.pixels != NULL);
+                for (unsigned long i = 0; i < total; i++) {
+                        unsigned value = Pnmrdr_get(newReader);
+                        assert (value <= maxval);
+                        info.pixels[i] = value;
+                        histogram[value]++;
+                }
+                info.threshold = otsu_threshold(histogram, maxval, total);
+                free(histogram);
+        }
+
+        /* store in the bit array */
+        Bit2_map_row_major(bit_array, get_gray_bit, &info);
+        free(info.pixels);
+        return bit_array;
+}
+
+
 /************************** run **************************
 *
 * This function runs removeblackedges. It creates a new pnmrdr reader, 
@@ -257,6 +472,8 @@ Bit2_T store_pbm(Pnmrdr_T newReader) {
 * 
 * Parameters:
 *       FILE *fp file pointer of picture to be whitened
+*       int threshold: threshold used to binarise a pgm, or OTSU_THRESHOLD
+*       int num_threads: threads to whiten with; 1 uses the serial fill
 *
 * Return: 
 *       Void
@@ -265,31 +482,42 @@ Bit2_T store_pbm(Pnmrdr_T newReader) {
 *       Valid file pointer
 *                        
 *****************************************************************/
-void run (FILE *fp) {
+void run (FILE *fp, int threshold, int num_threads) {
         assert(fp != NULL);
         Pnmrdr_T newReader = Pnmrdr_new(fp);
         assert (newReader != NULL);
         /* verify pgm is correctly formatted */
         Pnmrdr_mapdata newMapData = Pnmrdr_data(newReader);
         
-        assert(newMapData.type == 1);
+        assert(newMapData.type == Pnmrdr_bit || 
+               newMapData.type == Pnmrdr_gray);
         assert(newMapData.height != 0);
         assert(newMapData.width != 0);
 
         Seq_T stack = Seq_new(1000);
         
         
-        Bit2_T filled_array = store_pbm(newReader); /*obtain populated array */
+        Bit2_T filled_array; /*obtain populated array */
+        if (newMapData.type == Pnmrdr_gray) {
+                filled_array = store_pgm(newReader, threshold);
+        } else {
+                filled_array = store_pbm(newReader);
+        }
         assert (filled_array != NULL);
         assert(stack != NULL);
         add_edges(stack, filled_array); /*add edges to stack*/
         
         assert (filled_array != NULL);
         assert(stack != NULL);
-        process_bit(filled_array, stack); /*clean up the black edges*/
+        /*clean up the black edges*/
+        if (num_threads > 1) {
+                process_bit_parallel(filled_array, stack, num_threads);
+        } else {
+                process_bit(filled_array, stack);
+        }
 
         /* print the cleaned up array bit map */
-        printf("P%d\n", newMapData.type);
+        printf("P1\n");
         printf("%d %d\n", newMapData.width, newMapData.height);
         for (int i = 0; i < (int) newMapData.height; i++) {
                 for (int j = 0; j < (int) newMapData.width; j++) {
@@ -313,6 +541,9 @@ This function verifies that the correct args are passed, and handles whether
 * Parameters:
 *       User can either input a file, or run the program and then input 
 *       contents to stdin*
+*       -t threshold: gray value at or below which pgm pixels are black,
+*                     or "otsu" (the default) to compute one per image
+*       -j threads:   number of threads whitening the edges (default 1)
 * Return: 
 *       Void
 *
@@ -322,17 +553,37 @@ This function verifies that the correct args are passed, and handles whether
 *                        
 *****************************************************************/
 int main(int argc, char *argv[]) {
-        FILE *fp;
+        FILE *fp = stdin;
+        int threshold = OTSU_THRESHOLD;
+        int num_threads = 1;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "t:j:")) != -1) {
+                assert(opt == 't' || opt == 'j');
+                if (opt == 'j') {
+                        char *end;
+                        long value = strtol(optarg, &end, 10);
+                        assert(*optarg != '\0' && *end == '\0');
+                        assert(value >= 1 && value <= 1024);
+                        num_threads = (int) value;
+                } else if (strcmp(optarg, "otsu") == 0) {
+                        threshold = OTSU_THRESHOLD;
+                } else {
+                        char *end;
+                        long value = strtol(optarg, &end, 10);
+                        assert(*optarg != '\0' && *end == '\0');
+                        assert(value >= 0 && value <= 65535);
+                        threshold = (int) value;
+                }
+        }
         
-        assert(argc <= 2);
+        assert(argc - optind <= 1);
 
-        if (argc == 2) {
-                fp = fopen(argv[1], "r");
+        if (argc - optind == 1) {
+                fp = fopen(argv[optind], "r");
                 assert(fp != NULL);
-        } else if (argc == 1) {
-                fp = stdin;
         }
-        run(fp);
+        run(fp, threshold, num_threads);
         
         fclose(fp);
 }
\ No newline at end of file